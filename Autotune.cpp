@@ -0,0 +1,288 @@
+/*******************************************************************************
+
+	Copyright (C) 2015 by G. Nikolai "Weikardzaena" Kotula
+	<limitatinfinity11@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef	_WIN32
+#include <unistd.h>
+#endif
+
+#include "MandelbrotGenerator.h"
+
+using namespace std;
+
+/**
+ * Calibration renders are CALIBRATION_PIXELS square, of a stretch of the
+ * seahorse valley that has both members of the set and slow boundary pixels,
+ * and each setting is timed CALIBRATION_RUNS times keeping the best.
+ */
+static const unsigned int CALIBRATION_PIXELS = 512;
+static const unsigned int CALIBRATION_ITERATIONS = 1000;
+static const unsigned int CALIBRATION_RUNS = 2;
+static const char * const CALIBRATION_FILE = "autotune.tmp";
+
+/**
+ * The view every calibration render uses
+ */
+static View calibrationView()
+{
+	View view;
+
+	view.xStart = -0.85;
+	view.yStart = 0.0;
+	view.xStep = 0.2 / CALIBRATION_PIXELS;
+	view.yStep = 0.2 / CALIBRATION_PIXELS;
+	view.pixelCount = CALIBRATION_PIXELS;
+	view.iterations = CALIBRATION_ITERATIONS;
+
+	return view;
+}
+
+/**
+ * Best wall time of an escape-time render the way main() does it:  the cost
+ * estimate, then the pipelined render writing to a scratch file
+ */
+static double timePipelined(const RenderConfig &config)
+{
+	const View view = calibrationView();
+	const unsigned int n = view.pixelCount;
+	vector<vector<unsigned int>> iterationBuffer(n, vector<unsigned int>(n, 0));
+	vector<vector<bool>> escapeBuffer(n, vector<bool>(n, false));
+	vector<vector<char>> colorBuffer(n, vector<char>(n * 3, 0));
+	vector<unsigned char> tileState;
+	atomic<bool> cancel(false);
+	ofstream file;
+	Deadline start;
+	CostMap costs;
+	double best = HUGE_VAL;
+
+	file.open(CALIBRATION_FILE, ofstream::out | ofstream::trunc | ofstream::binary);
+
+	for (unsigned int run = 0; run < CALIBRATION_RUNS; ++run) {
+		start = chrono::steady_clock::now();
+		costs = estimateCost(view, config, NULL, Deadline::max(), cancel);
+		renderPipelined(iterationBuffer, escapeBuffer, colorBuffer, tileState,
+				view, config, Deadline::max(), cancel, file, 0, n * 3,
+				NULL, &costs);
+		best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+
+	file.close();
+	remove(CALIBRATION_FILE);
+
+	return best;
+}
+
+/**
+ * Best wall time of a distance-estimated render, whose tiles are square
+ */
+static double timeDistance(const RenderConfig &config)
+{
+	const View view = calibrationView();
+	vector<vector<float>> distanceBuffer(view.pixelCount, vector<float>(view.pixelCount, 0));
+	vector<unsigned char> tileState;
+	atomic<bool> cancel(false);
+	unsigned long long iterated;
+	Deadline start;
+	double best = HUGE_VAL;
+
+	for (unsigned int run = 0; run < CALIBRATION_RUNS; ++run) {
+		start = chrono::steady_clock::now();
+		renderDistanceTiles(distanceBuffer, tileState, view, config,
+				Deadline::max(), cancel, iterated);
+		best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+/**
+ * Tries every candidate value of one setting, with the others left as they
+ * are, and keeps the fastest
+ */
+static void tuneSetting(RenderConfig &config, unsigned int RenderConfig::*setting, const vector<unsigned int> &candidates, const char *name, double (*measure)(const RenderConfig &))
+{
+	RenderConfig trial = config;
+	double seconds, best = HUGE_VAL;
+
+	for (unsigned int c = 0; c < candidates.size(); ++c) {
+		trial.*setting = candidates[c];
+		seconds = measure(trial);
+		printf("\r    %-12s %4u: %.3fs\n", name, candidates[c], seconds);
+
+		if (seconds < best) {
+			best = seconds;
+			config.*setting = candidates[c];
+		}
+	}
+
+	printf("    -> %s = %u\n\n", name, config.*setting);
+}
+
+/**
+ * AUTOTUNE
+ *
+ * Finds the fastest settings for this machine by timing short calibration
+ * renders, tuning one setting at a time in the order they matter most:  the
+ * thread count, the kernel width and the band height on the escape-time
+ * render, then the tile size on the distance-estimated render.
+ */
+void autotune(RenderConfig &config)
+{
+	const unsigned int cores = max(thread::hardware_concurrency(), 1u);
+	vector<unsigned int> threads;
+	vector<unsigned int> lanes;
+	vector<unsigned int> bands;
+	vector<unsigned int> tiles;
+
+	for (unsigned int t = 1; t < cores; t *= 2)
+		threads.push_back(t);
+	threads.push_back(cores);
+	threads.push_back(cores * 2);
+
+	for (unsigned int l = 1; l <= MAX_LANES; l *= 2)
+		lanes.push_back(l);
+	for (unsigned int b = 1; b <= 64; b *= 2)
+		bands.push_back(b);
+	for (unsigned int t = 16; t <= 128; t *= 2)
+		tiles.push_back(t);
+
+	tuneSetting(config, &RenderConfig::threadCount, threads, "threads", timePipelined);
+	tuneSetting(config, &RenderConfig::kernelLanes, lanes, "kernel lanes", timePipelined);
+	tuneSetting(config, &RenderConfig::bandHeight, bands, "band height", timePipelined);
+	tuneSetting(config, &RenderConfig::tileSize, tiles, "tile size", timeDistance);
+}
+
+/**
+ * Name the profile is filed under:  the computer name on Windows, the host
+ * name elsewhere (from HOSTNAME, gethostname() or /etc/hostname, whichever
+ * works first), or "default" if none of them can be found
+ */
+string machineName()
+{
+	const char *name = getenv("COMPUTERNAME");
+	string host;
+	ifstream file;
+
+	if (name != NULL && *name != 0)
+		return name;
+
+	name = getenv("HOSTNAME");
+	if (name != NULL && *name != 0)
+		return name;
+
+#ifndef	_WIN32
+	char buffer[256] = { 0 };
+
+	if (gethostname(buffer, sizeof(buffer) - 1) == 0 && buffer[0] != 0)
+		return buffer;
+#endif
+
+	file.open("/etc/hostname");
+	if (file >> host)
+		return host;
+
+	return "default";
+}
+
+/**
+ * SAVE PROFILE
+ *
+ * The profile file holds one line per machine:
+ *
+ *	<machine> <threads> <kernel lanes> <band height> <tile size>
+ *
+ * This machine's line is replaced (or added); the others are kept, so several
+ * hosts can share a directory.  Returns false if the file could not be written.
+ */
+bool saveProfile(const RenderConfig &config, const string &fileName)
+{
+	const string machine = machineName();
+	vector<string> lines;
+	string line, name;
+	ifstream in;
+	ofstream out;
+
+	in.open(fileName.c_str());
+	while (getline(in, line)) {
+		istringstream fields(line);
+
+		if (line.empty() || line[0] == '#' || !(fields >> name))
+			continue;
+		if (name != machine)
+			lines.push_back(line);
+	}
+	in.close();
+
+	out.open(fileName.c_str(), ofstream::out | ofstream::trunc);
+	if (out.fail())
+		return false;
+
+	out << "# machine threads kernelLanes bandHeight tileSize\n";
+	for (unsigned int l = 0; l < lines.size(); ++l)
+		out << lines[l] << "\n";
+	out << machine << " " << config.threadCount << " " << config.kernelLanes <<
+		" " << config.bandHeight << " " << config.tileSize << "\n";
+
+	return !out.fail();
+}
+
+/**
+ * LOAD PROFILE
+ *
+ * Applies this machine's line of the profile file to config.  Returns false,
+ * leaving config alone, if there is no usable line for this machine.
+ */
+bool loadProfile(RenderConfig &config, const string &fileName)
+{
+	const string machine = machineName();
+	unsigned int threads, lanes, band, tile;
+	string line, name;
+	ifstream in;
+
+	in.open(fileName.c_str());
+	while (getline(in, line)) {
+		istringstream fields(line);
+
+		if (!(fields >> name) || name != machine)
+			continue;
+		if (!(fields >> threads >> lanes >> band >> tile) ||
+				threads == 0 || lanes == 0 || lanes > MAX_LANES ||
+				band == 0 || tile == 0)
+			return false;
+
+		config.threadCount = threads;
+		config.kernelLanes = lanes;
+		config.bandHeight = band;
+		config.tileSize = tile;
+		return true;
+	}
+
+	return false;
+}
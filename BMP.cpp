@@ -87,9 +87,6 @@ BMP fileSize (unsigned int rowSize, BMP bmp)
  */
 void writeBMP(vector<vector<char>> &buffer, ofstream &bmpPtr, unsigned int bufferLength, unsigned int pixelCount)
 {
-	for (unsigned int j = 0; j < pixelCount; ++j) {
-		for (unsigned int i = 0; i < bufferLength; ++i) {
-			bmpPtr.write(&buffer.at(j).at(i), 1);
-		}
-	}
+	for (unsigned int j = 0; j < pixelCount; ++j)
+		bmpPtr.write(&buffer.at(j).at(0), bufferLength);
 }
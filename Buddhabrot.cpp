@@ -0,0 +1,302 @@
+/*******************************************************************************
+
+	Copyright (C) 2015 by G. Nikolai "Weikardzaena" Kotula
+	<limitatinfinity11@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "MandelbrotGenerator.h"
+
+using namespace std;
+
+/**
+ * The sampling domain [-2, 2] x [-2, 2] is split into IMPORTANCE_GRID^2 cells
+ * for the low resolution pre-pass.  Each cell is probed IMPORTANCE_PROBES times
+ * with orbits cut off at IMPORTANCE_ITERATIONS.
+ */
+static const unsigned int IMPORTANCE_GRID = 256;
+static const unsigned int IMPORTANCE_PROBES = 4;
+static const unsigned int IMPORTANCE_ITERATIONS = 5000;
+
+/**
+ * Large mutations draw a fresh C from a mix of the importance map, the whole
+ * domain, and the view itself (a C in the view always starts its orbit there,
+ * which is what gets chains going on zoomed views the pre-pass cannot see).
+ * Without any pre-pass hits the importance share goes to the view.
+ */
+static const double MAP_FRACTION = 0.45;
+static const double DOMAIN_FRACTION = 0.1;
+
+/**
+ * Fraction of Metropolis-Hastings steps that are small mutations:  a jump in a
+ * random direction of up to SMALL_MUTATION view widths, most of them much
+ * shorter
+ */
+static const double SMALL_FRACTION = 0.8;
+static const double SMALL_MUTATION = 0.5;
+
+/**
+ * M_PI is not standard, and MSVC only has it with _USE_MATH_DEFINES
+ */
+static const double PI = 3.14159265358979323846;
+
+/**
+ * Number of samples a worker takes before checking the deadline again
+ */
+static const unsigned int SAMPLE_BATCH = 4096;
+
+/**
+ * Points inside the main cardioid or the period-2 bulb never escape, so there
+ * is no point iterating them
+ */
+static bool inMainBulbs(double x, double y)
+{
+	double q = (x - 0.25) * (x - 0.25) + y * y;
+
+	return q * (q + (x - 0.25)) <= 0.25 * y * y ||
+		(x + 1) * (x + 1) + y * y <= 0.0625;
+}
+
+/**
+ * Iterates C = x + yi up to the limit and, if the orbit escapes, appends the
+ * index of every pixel of the view that the orbit passed through to hits.
+ * Returns whether the orbit escaped; hits is left untouched if it did not.
+ */
+static bool traceOrbit(double x, double y, unsigned int iterations, const View &view, vector<unsigned int> &hits)
+{
+	double Z = 0, Zi = 0, Zp, Zip;
+	long long i, j;
+	size_t first = hits.size();
+
+	if (inMainBulbs(x, y))
+		return false;
+
+	for (unsigned int k = 1; k <= iterations; ++k) {
+		Zp = Z*Z - Zi*Zi + x;
+		Zip = 2*Z*Zi + y;
+
+		Z = Zp;
+		Zi = Zip;
+
+		if ((Z*Z + Zi*Zi) > 4)
+			return true;
+
+		i = (long long)floor((Z - view.xStart) / view.xStep);
+		j = (long long)floor((Zi - view.yStart) / view.yStep);
+		if (i >= 0 && j >= 0 && i < view.pixelCount && j < view.pixelCount)
+			hits.push_back((unsigned int)(j * view.pixelCount + i));
+	}
+
+	hits.resize(first);
+	return false;
+}
+
+/**
+ * BUDDHABROT RENDER
+ *
+ * Samples values of C over [-2, 2] x [-2, 2], and for every one whose orbit
+ * escapes within the iteration limit, adds to the density of each pixel of the
+ * view the orbit passed through.
+ *
+ * Samples are drawn by Metropolis-Hastings:  each worker runs a chain whose
+ * states C are visited in proportion to f(C), the number of points of C's
+ * orbit that land in the view.  Most steps nudge C a little (relative to the
+ * view size); the rest propose a fresh C from a mix of a coarse importance map
+ * of [-2, 2] x [-2, 2] (a pre-pass counting how often orbits from each cell
+ * land in the view), the whole domain and the view itself.  Proposals are
+ * accepted with the usual probability min(1, f(C') T(C) / (f(C) T(C'))), and
+ * every step the current orbit adds 1 / f(C) to each pixel it passes through,
+ * which makes the density converge to the uniform-sampling picture up to a
+ * constant factor (the colouring rescales anyway), while nearly every step is
+ * spent on orbits that actually reach the view, however far it is zoomed.
+ *
+ * Each worker accumulates into its own histogram and they are summed at the
+ * end, so no atomics are touched per orbit point.  Workers check the deadline
+ * and cancellation token between grid rows of the pre-pass and between batches
+ * of steps; stopping early only leaves the image noisier.
+ *
+ * Returns true if all samplesPerPixel * pixelCount^2 steps were taken.
+ */
+bool renderBuddhabrot(vector<vector<float>> &density, const View &view, const RenderConfig &config, double samplesPerPixel, Deadline deadline, const atomic<bool> &cancel)
+{
+	const unsigned int cells = IMPORTANCE_GRID * IMPORTANCE_GRID;
+	const double cellSize = 4.0 / IMPORTANCE_GRID;
+	const unsigned long long samples = (unsigned long long)(samplesPerPixel * view.pixelCount * view.pixelCount);
+	const unsigned long long batches = (samples + SAMPLE_BATCH - 1) / SAMPLE_BATCH;
+	const unsigned int threadCount = max(config.threadCount, 1u);
+
+	const double viewWidth = fabs(view.xStep) * view.pixelCount;
+	const double viewHeight = fabs(view.yStep) * view.pixelCount;
+	const double viewLeft = min(view.xStart, view.xStart + view.xStep * view.pixelCount);
+	const double viewBottom = min(view.yStart, view.yStart + view.yStep * view.pixelCount);
+
+	vector<double> cellHits(cells, 0);
+	vector<double> cdf(cells);
+	vector<vector<float>> histograms(threadCount);
+	atomic<unsigned int> nextRow(0);
+	atomic<unsigned long long> nextBatch(0);
+	atomic<unsigned long long> doneBatches(0);
+	double total = 0, mapFraction, viewFraction;
+
+	/**
+	 * Importance pre-pass, one grid row at a time
+	 */
+	runWorkers(threadCount, [&](unsigned int n) {
+		mt19937_64 rng(n + 1);
+		uniform_real_distribution<double> jitter(0, 1);
+		vector<unsigned int> hits;
+		unsigned int row;
+
+		while ((row = nextRow++) < IMPORTANCE_GRID) {
+			if (cancel || chrono::steady_clock::now() >= deadline)
+				break;
+
+			for (unsigned int col = 0; col < IMPORTANCE_GRID; ++col) {
+				hits.clear();
+				for (unsigned int p = 0; p < IMPORTANCE_PROBES; ++p)
+					traceOrbit(-2 + (col + jitter(rng)) * cellSize,
+						-2 + (row + jitter(rng)) * cellSize,
+						min(view.iterations, IMPORTANCE_ITERATIONS), view, hits);
+				cellHits[row * IMPORTANCE_GRID + col] = (double)hits.size();
+			}
+		}
+	});
+
+	for (unsigned int c = 0; c < cells; ++c) {
+		total += cellHits[c];
+		cdf[c] = total;
+	}
+
+	mapFraction = total > 0 ? MAP_FRACTION : 0;
+	viewFraction = 1 - DOMAIN_FRACTION - mapFraction;
+
+	/**
+	 * Density of the large mutation proposing C = x + yi
+	 */
+	auto proposal = [&](double x, double y) {
+		double t = 0;
+		unsigned int col, row;
+
+		if (x >= -2 && x < 2 && y >= -2 && y < 2) {
+			t += DOMAIN_FRACTION / 16;
+			if (mapFraction > 0) {
+				col = min((unsigned int)((x + 2) / cellSize), IMPORTANCE_GRID - 1);
+				row = min((unsigned int)((y + 2) / cellSize), IMPORTANCE_GRID - 1);
+				t += mapFraction * cellHits[row * IMPORTANCE_GRID + col] / total / (cellSize * cellSize);
+			}
+		}
+		if (x >= viewLeft && x < viewLeft + viewWidth && y >= viewBottom && y < viewBottom + viewHeight)
+			t += viewFraction / (viewWidth * viewHeight);
+
+		return t;
+	};
+
+	/**
+	 * Sampling
+	 */
+	runWorkers(threadCount, [&](unsigned int n) {
+		mt19937_64 rng(0x9E3779B97F4A7C15ULL + n);
+		uniform_real_distribution<double> uniform(0, 1);
+		vector<float> &histogram = histograms[n];
+		vector<unsigned int> hits, nextHits;
+		unsigned long long batch, done;
+		double x = 0, y = 0, nextX, nextY, u, r, angle, accept;
+		bool small;
+		unsigned int c;
+		float weight;
+
+		histogram.assign(view.pixelCount * view.pixelCount, 0);
+
+		while ((batch = nextBatch++) < batches) {
+			if (cancel || chrono::steady_clock::now() >= deadline)
+				break;
+
+			for (unsigned int s = 0; s < SAMPLE_BATCH; ++s) {
+				/* Until the chain has found an orbit that reaches the view, keep making large mutations */
+				small = !hits.empty() && uniform(rng) < SMALL_FRACTION;
+
+				if (small) {
+					r = viewWidth * SMALL_MUTATION * exp(-8 * uniform(rng));
+					angle = 2 * PI * uniform(rng);
+					nextX = x + r * cos(angle);
+					nextY = y + r * sin(angle);
+				} else if ((u = uniform(rng)) < mapFraction) {
+					c = (unsigned int)(lower_bound(cdf.begin(), cdf.end(),
+							uniform(rng) * total) - cdf.begin());
+					c = min(c, cells - 1);
+					nextX = -2 + (c % IMPORTANCE_GRID + uniform(rng)) * cellSize;
+					nextY = -2 + (c / IMPORTANCE_GRID + uniform(rng)) * cellSize;
+				} else if (u < mapFraction + DOMAIN_FRACTION) {
+					nextX = -2 + 4 * uniform(rng);
+					nextY = -2 + 4 * uniform(rng);
+				} else {
+					nextX = viewLeft + viewWidth * uniform(rng);
+					nextY = viewBottom + viewHeight * uniform(rng);
+				}
+
+				nextHits.clear();
+				traceOrbit(nextX, nextY, view.iterations, view, nextHits);
+
+				if (!nextHits.empty()) {
+					if (hits.empty())
+						accept = 1;
+					else if (small)
+						accept = (double)nextHits.size() / hits.size();
+					else
+						accept = (double)nextHits.size() * proposal(x, y) /
+							(hits.size() * proposal(nextX, nextY));
+
+					if (uniform(rng) < accept) {
+						x = nextX;
+						y = nextY;
+						swap(hits, nextHits);
+					}
+				}
+
+				if (hits.empty())
+					continue;
+
+				weight = 1.0f / hits.size();
+				for (size_t h = 0; h < hits.size(); ++h)
+					histogram[hits[h]] += weight;
+			}
+
+			done = ++doneBatches;
+			if (done * 100 / batches != (done - 1) * 100 / batches)
+				printf("\r%llu%%", done * 100 / batches);
+		}
+	});
+
+	/**
+	 * Merge the per-thread histograms
+	 */
+	for (unsigned int j = 0; j < view.pixelCount; ++j) {
+		for (unsigned int i = 0; i < view.pixelCount; ++i) {
+			density[j][i] = 0;
+			for (unsigned int n = 0; n < threadCount; ++n)
+				density[j][i] += histograms[n][j * view.pixelCount + i];
+		}
+	}
+
+	return doneBatches == batches;
+}
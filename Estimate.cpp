@@ -0,0 +1,194 @@
+/*******************************************************************************
+
+	Copyright (C) 2015 by G. Nikolai "Weikardzaena" Kotula
+	<limitatinfinity11@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "MandelbrotGenerator.h"
+
+using namespace std;
+
+/**
+ * One pixel in COST_SPACING x COST_SPACING is iterated for the estimate, which
+ * costs about 1/256th of the render itself
+ */
+static const unsigned int COST_SPACING = 16;
+
+/**
+ * Samples are iterated at most COST_ITERATIONS past where they start;  one
+ * that has still not escaped by then is taken to need the full limit.  The
+ * estimate is also given up if it takes more than 1/COST_BUDGET_SHARE of the
+ * time left before the deadline.
+ */
+static const unsigned int COST_ITERATIONS = 1 << 16;
+static const unsigned int COST_BUDGET_SHARE = 16;
+
+/**
+ * Expected iterations of pixel (i, j), taken from the nearest sample
+ */
+double pixelCost(const CostMap &costs, unsigned int i, unsigned int j)
+{
+	return costs.sampleCost[min(j / costs.spacing, costs.samplesPerRow - 1) * costs.samplesPerRow +
+		min(i / costs.spacing, costs.samplesPerRow - 1)];
+}
+
+/**
+ * RENDER COST ESTIMATE
+ *
+ * Iterates the pixel in the middle of every COST_SPACING x COST_SPACING block
+ * of the view and records how many iterations it took (the full limit for
+ * members of the set).  Scaling up the total gives the expected iterations for
+ * the whole render, and timing the pre-pass itself, on the same threads and
+ * with the same kernel width the render will use, turns that into an expected
+ * wall time.
+ *
+ * If pixels is given, each block's cost is scaled by the share of its pixels
+ * still to be computed:  known pixels cost nothing and resumed ones only the
+ * iterations past where they stopped.  A resumed sample carries on from its
+ * saved orbit rather than starting over.
+ *
+ * The deadline and cancellation token are checked between rows of samples.
+ * If either trips, or the estimate runs past its share of the time left, it
+ * is abandoned and the CostMap comes back with no samples.
+ */
+CostMap estimateCost(const View &view, const RenderConfig &config, const PixelState *pixels, Deadline deadline, const atomic<bool> &cancel)
+{
+	CostMap costs;
+	atomic<unsigned int> nextRow(0);
+	atomic<unsigned long long> iterated(0);
+	atomic<bool> abandoned(false);
+	vector<unsigned int> fresh, resumed, block;
+	Deadline start, cutoff;
+	double elapsed, total = 0;
+	unsigned int s;
+
+	costs.spacing = min(COST_SPACING, max(view.pixelCount, 1u));
+	costs.samplesPerRow = (view.pixelCount + costs.spacing - 1) / costs.spacing;
+	costs.sampleCost.assign(costs.samplesPerRow * costs.samplesPerRow, 0);
+	costs.iterations = 0;
+	costs.seconds = 0;
+
+	start = chrono::steady_clock::now();
+	cutoff = deadline > start ? start + (deadline - start) / COST_BUDGET_SHARE : start;
+
+	/**
+	 * Count the pixels of each block that still need computing up front, so
+	 * that only the sampling itself is timed for the rate
+	 */
+	fresh.assign(costs.sampleCost.size(), 0);
+	resumed.assign(costs.sampleCost.size(), 0);
+	block.assign(costs.sampleCost.size(), 0);
+
+	for (unsigned int j = 0; j < view.pixelCount; ++j) {
+		for (unsigned int i = 0; i < view.pixelCount; ++i) {
+			s = (j / costs.spacing) * costs.samplesPerRow + i / costs.spacing;
+			++block[s];
+			if (!pixels || (!pixels->known[j][i] && !pixels->resume[j][i]))
+				++fresh[s];
+			else if (pixels->resume[j][i])
+				++resumed[s];
+		}
+	}
+
+	start = chrono::steady_clock::now();
+
+	runWorkers(max(config.threadCount, 1u), [&](unsigned int) {
+		const unsigned int resumeFrom = pixels ? pixels->resumeFrom : 0;
+		const unsigned int n = costs.samplesPerRow;
+		vector<unsigned int> k(n), columns;
+		vector<vector<unsigned int>> rowBuffer(1, vector<unsigned int>(view.pixelCount, 0));
+		View rowView = view;
+		unsigned int row, i, j, limit;
+		unsigned long long count = 0;
+		double Z, Zi;
+
+		/* Fresh samples go through the render's own kernel, one row of the view at a time */
+		rowView.iterations = min(view.iterations, COST_ITERATIONS);
+
+		while ((row = nextRow++) < n) {
+			if (cancel || chrono::steady_clock::now() >= cutoff) {
+				abandoned = true;
+				break;
+			}
+
+			j = min(row * costs.spacing + costs.spacing / 2, view.pixelCount - 1);
+			rowView.yStart = view.yStart + j * view.yStep;
+			columns.clear();
+
+			for (unsigned int col = 0; col < n; ++col) {
+				i = min(col * costs.spacing + costs.spacing / 2, view.pixelCount - 1);
+
+				if (fresh[row * n + col] + resumed[row * n + col] == 0)
+					continue;
+
+				if (pixels && pixels->resume[j][i]) {
+					/* Resumed pixels are carried on one at a time, as the render does */
+					Z = pixels->Z[j][i];
+					Zi = pixels->Zi[j][i];
+					limit = resumeFrom + min(COST_ITERATIONS, view.iterations - resumeFrom);
+					k[col] = escapeTimeResume(view.xStart + i * view.xStep,
+							rowView.yStart, resumeFrom, limit, Z, Zi);
+					count += (k[col] != 0 ? k[col] : limit) - resumeFrom;
+					if (k[col] == 0)
+						k[col] = view.iterations;
+				} else {
+					columns.push_back(i);
+				}
+			}
+
+			renderColumns(rowBuffer, rowView, 0, columns, config.kernelLanes, NULL);
+
+			for (unsigned int col = 0; col < n; ++col) {
+				i = min(col * costs.spacing + costs.spacing / 2, view.pixelCount - 1);
+
+				if (fresh[row * n + col] + resumed[row * n + col] == 0)
+					continue;
+				if (!pixels || !pixels->resume[j][i]) {
+					k[col] = rowBuffer[0][i];
+					count += k[col] != 0 ? k[col] : rowView.iterations;
+					if (k[col] == 0)
+						k[col] = view.iterations;
+				}
+
+				costs.sampleCost[row * n + col] = ((double)fresh[row * n + col] * k[col] +
+						(double)resumed[row * n + col] * (k[col] > resumeFrom ? k[col] - resumeFrom : 0)) /
+						block[row * n + col];
+			}
+		}
+
+		iterated += count;
+	});
+
+	if (abandoned) {
+		costs.sampleCost.clear();
+		return costs;
+	}
+
+	elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	for (s = 0; s < costs.sampleCost.size(); ++s)
+		total += costs.sampleCost[s];
+
+	costs.iterations = total * ((double)view.pixelCount * view.pixelCount / costs.sampleCost.size());
+	costs.seconds = iterated > 0 && elapsed > 0 ? costs.iterations / (iterated / elapsed) : 0;
+
+	return costs;
+}
@@ -0,0 +1,259 @@
+/*******************************************************************************
+
+	Copyright (C) 2015 by G. Nikolai "Weikardzaena" Kotula
+	<limitatinfinity11@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+/**
+ * There's a silly error about fopen not being safe or something when compiling
+ * on windows, so we need this to tell the compiler to ignore it.
+ */
+#ifdef	_MSC_VER
+#define	_CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "MandelbrotGenerator.h"
+
+using namespace std;
+
+/**
+ * How close (as a fraction of a pixel) a pixel of a new view has to sit to a
+ * pixel of the last one for its value to be reused
+ */
+static const double REUSE_TOLERANCE = 1e-6;
+
+/**
+ * First four bytes of a saved frame ("MSGF"), followed by the format version
+ */
+static const unsigned int FRAME_MAGIC = 0x4647534D;
+static const unsigned int FRAME_VERSION = 1;
+
+/**
+ * Finds where each row or column of the new grid falls on the old one:  the
+ * index of the old pixel sitting at the same coordinate, or -1 if none does.
+ */
+static vector<int> alignAxis(double start, double step, double lastStart, double lastStep, unsigned int pixelCount)
+{
+	vector<int> map(pixelCount, -1);
+	double u;
+	long long n;
+
+	for (unsigned int i = 0; i < pixelCount; ++i) {
+		u = (start + i * step - lastStart) / lastStep;
+		n = llround(u);
+		if (n >= 0 && n < (long long)pixelCount && fabs(u - n) < REUSE_TOLERANCE)
+			map[i] = (int)n;
+	}
+
+	return map;
+}
+
+/**
+ * CROSS-VIEW PIXEL REUSE
+ *
+ * Sets up pixels for rendering view, taking whatever it can from the last
+ * frame.  Every pixel of the new view that lands exactly (to within
+ * REUSE_TOLERANCE of a pixel) on a fully computed pixel of the last frame is
+ * carried over:  a pan by a whole number of pixels reuses the overlap, a 2x
+ * zoom in reuses every other row and column, and a view that does not line up
+ * at all reuses nothing.
+ *
+ * If the iteration limit is the same, carried over pixels are simply known.
+ * If it has been raised, pixels that escaped are still known (they escape on
+ * the same iteration) but the ones that did not are resumed from the orbit the
+ * last frame left them on.  Lowering the limit reuses nothing.
+ *
+ * Returns the number of pixels carried over, of which resumed were resumed.
+ */
+unsigned int reuseFrame(const Frame &last, const View &view, vector<vector<unsigned int>> &iterationBuffer, PixelState &pixels, unsigned int &resumed)
+{
+	unsigned int reused = 0;
+	unsigned int r, c;
+	vector<int> columns, rows;
+
+	pixels.known.assign(view.pixelCount, vector<bool>(view.pixelCount, false));
+	pixels.resume.assign(view.pixelCount, vector<bool>(view.pixelCount, false));
+	pixels.resumeFrom = last.view.iterations;
+	pixels.Z.assign(view.pixelCount, vector<double>(view.pixelCount, 0));
+	pixels.Zi.assign(view.pixelCount, vector<double>(view.pixelCount, 0));
+	resumed = 0;
+
+	if (last.view.pixelCount != view.pixelCount || last.view.iterations > view.iterations)
+		return 0;
+
+	columns = alignAxis(view.xStart, view.xStep, last.view.xStart, last.view.xStep, view.pixelCount);
+	rows = alignAxis(view.yStart, view.yStep, last.view.yStart, last.view.yStep, view.pixelCount);
+
+	for (unsigned int j = 0; j < view.pixelCount; ++j) {
+		if (rows[j] < 0)
+			continue;
+		r = rows[j];
+
+		for (unsigned int i = 0; i < view.pixelCount; ++i) {
+			if (columns[i] < 0 || !last.valid[r][columns[i]])
+				continue;
+			c = columns[i];
+
+			iterationBuffer[j][i] = last.iterationBuffer[r][c];
+			pixels.Z[j][i] = last.Z[r][c];
+			pixels.Zi[j][i] = last.Zi[r][c];
+
+			if (iterationBuffer[j][i] == 0 && last.view.iterations < view.iterations) {
+				pixels.resume[j][i] = true;
+				++resumed;
+			} else {
+				pixels.known[j][i] = true;
+			}
+			++reused;
+		}
+	}
+
+	return reused;
+}
+
+/**
+ * Keeps the render that just finished as the last frame.  The iteration data
+ * and orbits are swapped rather than copied, so iterationBuffer is left holding
+ * stale values.  Pixels are valid if their tile was computed at full quality or
+ * they were carried over as known from a valid pixel.
+ */
+void keepFrame(Frame &last, const View &view, vector<vector<unsigned int>> &iterationBuffer, PixelState &pixels, const vector<unsigned char> &tileState, const RenderConfig &config)
+{
+	const unsigned int bandHeight = max(config.bandHeight, 1u);
+	const unsigned int tileWidth = max(config.tileSize, 1u);
+	const unsigned int tilesPerBand = (view.pixelCount + tileWidth - 1) / tileWidth;
+
+	last.view = view;
+	swap(last.iterationBuffer, iterationBuffer);
+	swap(last.Z, pixels.Z);
+	swap(last.Zi, pixels.Zi);
+	last.valid.assign(view.pixelCount, vector<bool>(view.pixelCount, false));
+
+	/* The pipelined render's tiles are tileSize wide slices of each band */
+	for (unsigned int j = 0; j < view.pixelCount; ++j)
+		for (unsigned int i = 0; i < view.pixelCount; ++i)
+			last.valid[j][i] = tileState[(j / bandHeight) * tilesPerBand + i / tileWidth] == TILE_FULL ||
+				pixels.known[j][i];
+
+	if (iterationBuffer.size() != view.pixelCount)
+		iterationBuffer.assign(view.pixelCount, vector<unsigned int>(view.pixelCount, 0));
+}
+
+/**
+ * SAVE FRAME
+ *
+ * Writes a frame to disk so a later run can raise the iteration limit on it.
+ * The file holds, in order:  the magic number and version, the View, a bit per
+ * pixel for whether it is valid, the iteration count of every pixel, and then
+ * Z and Zi (two doubles) only for the valid pixels that did not escape.
+ *
+ * Returns false if the file could not be written or there is no frame to save.
+ */
+bool saveFrame(const Frame &frame, const string &fileName)
+{
+	const unsigned int n = frame.view.pixelCount;
+	vector<unsigned char> bits((n * n + 7) / 8, 0);
+	FILE *file;
+	bool ok;
+
+	if (n == 0)
+		return false;
+
+	file = fopen(fileName.c_str(), "wb");
+	if (file == NULL)
+		return false;
+
+	for (unsigned int j = 0; j < n; ++j)
+		for (unsigned int i = 0; i < n; ++i)
+			if (frame.valid[j][i])
+				bits[(j * n + i) / 8] |= 1 << ((j * n + i) % 8);
+
+	ok = fwrite(&FRAME_MAGIC, sizeof(unsigned int), 1, file) == 1 &&
+		fwrite(&FRAME_VERSION, sizeof(unsigned int), 1, file) == 1 &&
+		fwrite(&frame.view, sizeof(View), 1, file) == 1 &&
+		fwrite(&bits[0], 1, bits.size(), file) == bits.size();
+
+	for (unsigned int j = 0; ok && j < n; ++j)
+		ok = fwrite(&frame.iterationBuffer[j][0], sizeof(unsigned int), n, file) == n;
+
+	for (unsigned int j = 0; ok && j < n; ++j) {
+		for (unsigned int i = 0; ok && i < n; ++i) {
+			if (frame.valid[j][i] && frame.iterationBuffer[j][i] == 0)
+				ok = fwrite(&frame.Z[j][i], sizeof(double), 1, file) == 1 &&
+					fwrite(&frame.Zi[j][i], sizeof(double), 1, file) == 1;
+		}
+	}
+
+	return fclose(file) == 0 && ok;
+}
+
+/**
+ * LOAD FRAME
+ *
+ * Reads a frame written by saveFrame.  Returns false (leaving frame empty) if
+ * the file is missing, truncated, not a saved frame or holds an empty view.
+ */
+bool loadFrame(Frame &frame, const string &fileName)
+{
+	unsigned int magic = 0, version = 0, n;
+	vector<unsigned char> bits;
+	FILE *file;
+	bool ok;
+
+	file = fopen(fileName.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	ok = fread(&magic, sizeof(unsigned int), 1, file) == 1 &&
+		fread(&version, sizeof(unsigned int), 1, file) == 1 &&
+		magic == FRAME_MAGIC && version == FRAME_VERSION &&
+		fread(&frame.view, sizeof(View), 1, file) == 1 &&
+		frame.view.pixelCount > 0 && frame.view.pixelCount <= 0xffff;
+
+	n = ok ? frame.view.pixelCount : 0;
+	bits.assign((n * n + 7) / 8, 0);
+	frame.valid.assign(n, vector<bool>(n, false));
+	frame.iterationBuffer.assign(n, vector<unsigned int>(n, 0));
+	frame.Z.assign(n, vector<double>(n, 0));
+	frame.Zi.assign(n, vector<double>(n, 0));
+
+	ok = ok && fread(&bits[0], 1, bits.size(), file) == bits.size();
+
+	for (unsigned int j = 0; ok && j < n; ++j)
+		ok = fread(&frame.iterationBuffer[j][0], sizeof(unsigned int), n, file) == n;
+
+	for (unsigned int j = 0; ok && j < n; ++j) {
+		for (unsigned int i = 0; ok && i < n; ++i) {
+			frame.valid[j][i] = (bits[(j * n + i) / 8] >> ((j * n + i) % 8)) & 1;
+			if (frame.valid[j][i] && frame.iterationBuffer[j][i] == 0)
+				ok = fread(&frame.Z[j][i], sizeof(double), 1, file) == 1 &&
+					fread(&frame.Zi[j][i], sizeof(double), 1, file) == 1;
+		}
+	}
+
+	fclose(file);
+
+	if (!ok)
+		frame = Frame();
+	return ok;
+}
@@ -20,7 +20,11 @@
 #ifndef MANDELBROTGENERATOR_H
 #define MANDELBROTGENERATOR_H
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <functional>
+#include <string>
 #include <vector>
 
 using namespace std;
@@ -66,6 +70,98 @@ struct BMP
  */
 #pragma pack(pop)
 
+/**
+ * Mapping of the pixel grid onto the complex plane.  Pixel (i, j) sits at
+ * xStart + i * xStep, yStart + j * yStep.
+ */
+struct View
+{
+	double       xStart; /*!< Real coordinate of the first column */
+	double       yStart; /*!< Imaginary coordinate of the first row */
+	double       xStep; /*!< Width of each pixel in the complex plane */
+	double       yStep; /*!< Height of each pixel in the complex plane */
+	unsigned int pixelCount; /*!< Number of pixels in both the x and y directions */
+	unsigned int iterations; /*!< Iteration limit for each pixel */
+};
+
+/**
+ * Widest multi-lane escape-time kernel
+ */
+const unsigned int MAX_LANES = 8;
+
+/**
+ * Knobs for how the calculation is split up between threads
+ */
+struct RenderConfig
+{
+	RenderConfig();
+
+	unsigned int tileSize; /*!< Width and height of a tile in pixels */
+	unsigned int bandHeight; /*!< Rows per band in the pipelined render */
+	unsigned int kernelLanes; /*!< Pixels iterated side by side (1, 2, 4 or MAX_LANES) */
+	unsigned int threadCount; /*!< Number of worker threads */
+};
+
+/**
+ * What happened to each tile of a render
+ */
+enum TileState
+{
+	TILE_PENDING = 0, /*!< Not reached yet */
+	TILE_FULL, /*!< Every pixel computed at the full iteration limit */
+	TILE_COARSE, /*!< Sparse samples at a reduced limit (deadline passed) */
+	TILE_SKIPPED /*!< Left black because the render was cancelled */
+};
+
+/**
+ * What an escape-time render starts out knowing about each pixel, and where it
+ * leaves the orbits of the pixels that did not escape
+ */
+struct PixelState
+{
+	vector<vector<bool>>   known; /*!< Pixel already holds its final iteration count */
+	vector<vector<bool>>   resume; /*!< Pixel carries on from Z, Zi instead of from 0 */
+	unsigned int           resumeFrom; /*!< Iterations already done on resumed pixels */
+	vector<vector<double>> Z; /*!< Real part of the orbit where each pixel stopped */
+	vector<vector<double>> Zi; /*!< Imaginary part of the orbit where each pixel stopped */
+};
+
+/**
+ * The last escape-time render, kept so that the next view can reuse whatever
+ * pixels of it line up exactly, and continue the ones that had not escaped if
+ * the iteration limit goes up
+ */
+struct Frame
+{
+	Frame() { view.pixelCount = 0; view.iterations = 0; }
+
+	View                         view; /*!< Where the frame was rendered */
+	vector<vector<unsigned int>> iterationBuffer; /*!< Escape iteration of each pixel */
+	vector<vector<bool>>         valid; /*!< Pixels computed at full quality */
+	vector<vector<double>>       Z; /*!< Real part of the final orbit of pixels that did not escape */
+	vector<vector<double>>       Zi; /*!< Imaginary part of the final orbit of pixels that did not escape */
+};
+
+/**
+ * Expected cost of an escape-time render, from iterating a sparse grid of its
+ * pixels.  Each pixel is expected to cost the same as the nearest sample.
+ */
+struct CostMap
+{
+	unsigned int   spacing; /*!< Pixels between samples in each direction */
+	unsigned int   samplesPerRow; /*!< Samples along each row (and column) */
+	vector<double> sampleCost; /*!< Iterations per pixel of each sample's block, row-major (empty if abandoned) */
+	double         iterations; /*!< Expected iterations for the whole render */
+	double         seconds; /*!< Expected wall time of the whole render (0 if unknown) */
+};
+
+typedef chrono::steady_clock::time_point Deadline;
+
+/**
+ * Distance (in pixels) from the set past which distance colouring is saturated
+ */
+const float DE_SHADE_PIXELS = 4.0f;
+
 /**
  * Function Prototypes
  */
@@ -73,9 +169,29 @@ unsigned int getBufferLength(unsigned int xRes, BMP bmp);
 BMP          setDimensions(unsigned int xRes, unsigned int yRes, BMP bmp);
 BMP          fileSize(unsigned int rowSize, BMP bmp);
 void         normalize(vector<vector<unsigned int>> &data, vector<vector<bool>> &escape, unsigned int length, unsigned int iterations);
-void         hsvToRGB(vector<vector<char>> &colorData, vector<vector<unsigned int>> &hue, vector<vector<bool>> &escape, unsigned int pixelCount);
+void         hsvToRGBRow(vector<char> &colorData, vector<unsigned int> &hue, vector<bool> &escape, unsigned int pixelCount);
+void         distanceToRGB(vector<vector<char>> &colorData, vector<vector<float>> &distance, unsigned int pixelCount);
+void         densityToRGB(vector<vector<char>> &colorData, vector<vector<float>> &density, unsigned int pixelCount);
 void         writeBMP(vector<vector<char>> &buffer, ofstream &bmpPtr, unsigned int bufferLength, unsigned int pixelCount);
 string       fileSizeToString(unsigned int size);
+unsigned int escapeTime(double x, double y, unsigned int iterations);
+unsigned int escapeTimeResume(double x, double y, unsigned int done, unsigned int iterations, double &Z, double &Zi);
+void         renderColumns(vector<vector<unsigned int>> &iterationBuffer, const View &view, unsigned int j, const vector<unsigned int> &columns, unsigned int lanes, PixelState *pixels);
+void         runWorkers(unsigned int threadCount, const function<void(unsigned int)> &work);
+double       distanceEstimate(double x, double y, unsigned int iterations);
+bool         renderPipelined(vector<vector<unsigned int>> &iterationBuffer, vector<vector<bool>> &escapeBuffer, vector<vector<char>> &colorBuffer, vector<unsigned char> &tileState, const View &view, const RenderConfig &config, Deadline deadline, const atomic<bool> &cancel, ofstream &file, streamoff dataOffset, unsigned int bufferLength, PixelState *pixels, const CostMap *costs);
+CostMap      estimateCost(const View &view, const RenderConfig &config, const PixelState *pixels, Deadline deadline, const atomic<bool> &cancel);
+double       pixelCost(const CostMap &costs, unsigned int i, unsigned int j);
+unsigned int reuseFrame(const Frame &last, const View &view, vector<vector<unsigned int>> &iterationBuffer, PixelState &pixels, unsigned int &resumed);
+void         keepFrame(Frame &last, const View &view, vector<vector<unsigned int>> &iterationBuffer, PixelState &pixels, const vector<unsigned char> &tileState, const RenderConfig &config);
+bool         saveFrame(const Frame &frame, const string &fileName);
+bool         loadFrame(Frame &frame, const string &fileName);
+void         autotune(RenderConfig &config);
+string       machineName();
+bool         saveProfile(const RenderConfig &config, const string &fileName);
+bool         loadProfile(RenderConfig &config, const string &fileName);
+bool         renderDistanceTiles(vector<vector<float>> &distanceBuffer, vector<unsigned char> &tileState, const View &view, const RenderConfig &config, Deadline deadline, const atomic<bool> &cancel, unsigned long long &iterated);
+bool         renderBuddhabrot(vector<vector<float>> &density, const View &view, const RenderConfig &config, double samplesPerPixel, Deadline deadline, const atomic<bool> &cancel);
 
 #endif //MANDELBROTGENERATOR_H
 
@@ -18,10 +18,13 @@
 
 *******************************************************************************/
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include <cstdio>
 
+#include "MandelbrotGenerator.h"
+
 using namespace std;
 
 /**
@@ -48,55 +51,83 @@ void normalize(vector<vector<unsigned int>> &data, vector<vector<bool>> &escape,
  * representation (with max value).
  *
  * See <http://en.wikipedia.org/wiki/HSL_and_HSV#Converting_to_RGB> for an
- * explanation of the algorithm. */
+ * explanation of the algorithm.  hsvToRGBRow converts a single row so the
+ * colouring can keep up with rows as they come out of the calculation. */
 
-void hsvToRGB(vector<vector<char>> &colorData, vector<vector<unsigned int>> &hue, vector<vector<bool>> &escape, unsigned int pixelCount)
+void hsvToRGBRow(vector<char> &colorData, vector<unsigned int> &hue, vector<bool> &escape, unsigned int pixelCount)
 {
 	const float V = 1;
 	float hueP, X, S, C;
 
+	for (unsigned int i = 0; i < pixelCount; ++i) {
+
+		/**
+		 * This escape flag is needed because sometimes the RGB
+		 * conversion spits out 0, so we can't rely on purely
+		 * that hue value to determine if the point is in the
+		 * set or not
+		 */
+
+		if (escape.at(i)) {
+			// Set parameters needed to calculate color
+			hueP = (float)(hue.at(i) % 360) / 60;
+			S = 1;
+			X = S * (1 - fabs(fmod(hueP, 2) - 1));
+			C = V - S;
+			
+			if (hueP >= 0 && hueP < 1) {
+				colorData.at(i * 3) = (S + C) * 255;
+				colorData.at(i * 3 + 1) = (X + C) * 255;
+				colorData.at(i * 3 + 2) = C * 255;
+			} else if (hueP >= 1 && hueP < 2) {
+				colorData.at(i * 3) = (X + C) * 255;
+				colorData.at(i * 3 + 1) = (S + C) * 255;
+				colorData.at(i * 3 + 2) = C * 255;
+			} else if (hueP >= 2 && hueP < 3) {
+				colorData.at(i * 3) = C * 255;
+				colorData.at(i * 3 + 1) = (S + C) * 255;
+				colorData.at(i * 3 + 2) = (X + C) * 255;
+			} else if (hueP >= 3 && hueP < 4) {
+				colorData.at(i * 3) = C * 255;
+				colorData.at(i * 3 + 1) = (X + C) * 255;
+				colorData.at(i * 3 + 2) = (S + C) * 255;
+			} else if (hueP >= 4 && hueP < 5) {
+				colorData.at(i * 3) = (X + C) * 255;
+				colorData.at(i * 3 + 1) = C * 255;
+				colorData.at(i * 3 + 2) = (S + C) * 255;
+			} else if (hueP >= 5 && hueP < 6) {
+				colorData.at(i * 3) = (S + C) * 255;
+				colorData.at(i * 3 + 1) = C * 255;
+				colorData.at(i * 3 + 2) = (X + C) * 255;
+			}
+		} else {
+			colorData.at(i * 3) = 0;
+			colorData.at(i * 3 + 1) = 0;
+			colorData.at(i * 3 + 2) = 0;
+		}
+	}
+}
+
+
+/**
+ * DISTANCE COLOURING
+ *
+ * Shades each exterior pixel by its estimated distance to the set (in pixels):
+ * the boundary filaments come out dark and everything DE_SHADE_PIXELS or more
+ * away is white.  Members of the set (distance 0) stay black.
+ */
+
+void distanceToRGB(vector<vector<char>> &colorData, vector<vector<float>> &distance, unsigned int pixelCount)
+{
+	float shade;
+
 	for (unsigned int j = 0; j < pixelCount; ++j) {
 		for (unsigned int i = 0; i < pixelCount; ++i) {
-
-			/**
-			 * This escape flag is needed because sometimes the RGB
-			 * conversion spits out 0, so we can't rely on purely
-			 * that hue value to determine if the point is in the
-			 * set or not
-			 */
-
-			if (escape.at(j).at(i)) {
-				// Set parameters needed to calculate color
-				hueP = (float)(hue.at(j).at(i) % 360) / 60;
-				S = 1;
-				X = S * (1 - fabs(fmod(hueP, 2) - 1));
-				C = V - S;
-				
-				if (hueP >= 0 && hueP < 1) {
-					colorData.at(j).at(i * 3) = (S + C) * 255;
-					colorData.at(j).at(i * 3 + 1) = (X + C) * 255;
-					colorData.at(j).at(i * 3 + 2) = C * 255;
-				} else if (hueP >= 1 && hueP < 2) {
-					colorData.at(j).at(i * 3) = (X + C) * 255;
-					colorData.at(j).at(i * 3 + 1) = (S + C) * 255;
-					colorData.at(j).at(i * 3 + 2) = C * 255;
-				} else if (hueP >= 2 && hueP < 3) {
-					colorData.at(j).at(i * 3) = C * 255;
-					colorData.at(j).at(i * 3 + 1) = (S + C) * 255;
-					colorData.at(j).at(i * 3 + 2) = (X + C) * 255;
-				} else if (hueP >= 3 && hueP < 4) {
-					colorData.at(j).at(i * 3) = C * 255;
-					colorData.at(j).at(i * 3 + 1) = (X + C) * 255;
-					colorData.at(j).at(i * 3 + 2) = (S + C) * 255;
-				} else if (hueP >= 4 && hueP < 5) {
-					colorData.at(j).at(i * 3) = (X + C) * 255;
-					colorData.at(j).at(i * 3 + 1) = C * 255;
-					colorData.at(j).at(i * 3 + 2) = (S + C) * 255;
-				} else if (hueP >= 5 && hueP < 6) {
-					colorData.at(j).at(i * 3) = (S + C) * 255;
-					colorData.at(j).at(i * 3 + 1) = C * 255;
-					colorData.at(j).at(i * 3 + 2) = (X + C) * 255;
-				}
+			if (distance.at(j).at(i) > 0) {
+				shade = sqrt(fmin(distance.at(j).at(i) / DE_SHADE_PIXELS, 1.0f));
+				colorData.at(j).at(i * 3) = (unsigned char)(shade * 255);
+				colorData.at(j).at(i * 3 + 1) = (unsigned char)(shade * 255);
+				colorData.at(j).at(i * 3 + 2) = (unsigned char)(shade * 255);
 			} else {
 				colorData.at(j).at(i * 3) = 0;
 				colorData.at(j).at(i * 3 + 1) = 0;
@@ -106,3 +137,34 @@ void hsvToRGB(vector<vector<char>> &colorData, vector<vector<unsigned int>> &hue
 	}
 }
 
+/**
+ * DENSITY COLOURING
+ *
+ * Maps Buddhabrot orbit densities to a brightness.  The densities are scaled
+ * so the 99.9th percentile is full brightness (a handful of hot pixels would
+ * otherwise wash out the rest) and square-rooted to bring out the faint
+ * orbits.
+ */
+
+void densityToRGB(vector<vector<char>> &colorData, vector<vector<float>> &density, unsigned int pixelCount)
+{
+	vector<float> sorted;
+	float scale, shade;
+
+	for (unsigned int j = 0; j < pixelCount; ++j)
+		sorted.insert(sorted.end(), density.at(j).begin(), density.at(j).begin() + pixelCount);
+
+	nth_element(sorted.begin(), sorted.begin() + sorted.size() * 999 / 1000, sorted.end());
+	scale = sorted[sorted.size() * 999 / 1000];
+	if (scale <= 0)
+		scale = 1;
+
+	for (unsigned int j = 0; j < pixelCount; ++j) {
+		for (unsigned int i = 0; i < pixelCount; ++i) {
+			shade = sqrt(fmin(density.at(j).at(i) / scale, 1.0f));
+			colorData.at(j).at(i * 3) = (unsigned char)(shade * 255);
+			colorData.at(j).at(i * 3 + 1) = (unsigned char)(shade * 255);
+			colorData.at(j).at(i * 3 + 2) = (unsigned char)(shade * 255);
+		}
+	}
+}
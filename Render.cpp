@@ -0,0 +1,622 @@
+/*******************************************************************************
+
+	Copyright (C) 2015 by G. Nikolai "Weikardzaena" Kotula
+	<limitatinfinity11@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MandelbrotGenerator.h"
+
+using namespace std;
+
+/**
+ * Once the deadline has passed, unfinished tiles are only sampled every
+ * COARSE_STEP pixels in each direction, and never past COARSE_ITERATIONS.
+ */
+static const unsigned int COARSE_STEP = 4;
+static const unsigned int COARSE_ITERATIONS = 256;
+
+/**
+ * Escape radius squared used by the distance estimator
+ */
+static const double DE_BAILOUT = 1e10;
+
+/* RenderConfig constructor */
+RenderConfig::RenderConfig()
+{
+	tileSize = 32;
+	bandHeight = 8;
+	kernelLanes = 1;
+	threadCount = thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+}
+
+/**
+ * ESCAPE TIME KERNEL
+ *
+ * Iterates Z = Z*Z + C for C = x + yi, picking up from Z after done iterations,
+ * and returns the iteration on which the sum escaped, or 0 if it had not
+ * escaped by the limit.  In that case Z is left where the orbit stopped so
+ * that it can be continued to a higher limit later, with the same result as
+ * iterating from scratch.
+ */
+static inline unsigned int escapeTimeFrom(double x, double y, unsigned int done, unsigned int iterations, double &Z, double &Zi)
+{
+	double Zr = Z, Zim = Zi, Zp, Zip;
+
+	/* k starts at 1 so an escape on the first iteration is never 0 */
+	for (unsigned int k = done + 1; k <= iterations; ++k) {
+		Zp = Zr*Zr - Zim*Zim + x;
+		Zip = 2*Zr*Zim + y;
+
+		Zr = Zp;
+		Zim = Zip;
+
+		if ((Zr*Zr + Zim*Zim) > 4)
+			return k;
+	}
+
+	Z = Zr;
+	Zi = Zim;
+	return 0;
+}
+
+/**
+ * Escape time from scratch; 0 means the point is a member of the set
+ */
+unsigned int escapeTime(double x, double y, unsigned int iterations)
+{
+	double Z = 0, Zi = 0;
+
+	return escapeTimeFrom(x, y, 0, iterations, Z, Zi);
+}
+
+/**
+ * Escape time carrying on from an orbit left at Z after done iterations; Z is
+ * updated if the point has still not escaped by the limit
+ */
+unsigned int escapeTimeResume(double x, double y, unsigned int done, unsigned int iterations, double &Z, double &Zi)
+{
+	return escapeTimeFrom(x, y, done, iterations, Z, Zi);
+}
+
+/**
+ * DISTANCE ESTIMATOR KERNEL
+ *
+ * Same iteration as escapeTime, but also carries the derivative dZ/dC
+ * (dZ = 2*Z*dZ + 1) so that an escaping point yields the exterior distance
+ * estimate |Z| ln|Z|^2 / |dZ| in the complex plane.  The true distance to the
+ * set lies between a quarter of the estimate and the estimate itself.
+ *
+ * Once the sum passes the usual radius of 2 it is known to escape, so it is
+ * iterated a little past the limit if need be until it reaches DE_BAILOUT,
+ * where the estimate is accurate.  Returns 0 for members of the set.
+ */
+double distanceEstimate(double x, double y, unsigned int iterations)
+{
+	double Z = 0, Zi = 0, dZ = 0, dZi = 0, Zp, Zip, dZp, r2;
+	bool escaped = false;
+
+	for (unsigned int k = 1; k <= iterations || escaped; ++k) {
+		dZp = 2*(Z*dZ - Zi*dZi) + 1;
+		dZi = 2*(Z*dZi + Zi*dZ);
+		dZ = dZp;
+
+		Zp = Z*Z - Zi*Zi + x;
+		Zip = 2*Z*Zi + y;
+
+		Z = Zp;
+		Zi = Zip;
+
+		r2 = Z*Z + Zi*Zi;
+		if (r2 > DE_BAILOUT)
+			return sqrt(r2) * log(r2) / sqrt(dZ*dZ + dZi*dZi);
+		if (r2 > 4)
+			escaped = true;
+	}
+
+	return 0;
+}
+
+/**
+ * MULTI-LANE ESCAPE TIME KERNEL
+ *
+ * Runs the escapeTime iteration on LANES points of the same row side by side,
+ * so the compiler can keep them in vector registers.  Lanes that have escaped
+ * keep being iterated (their values are simply ignored) until every lane has
+ * escaped or the limit is reached.  Each lane does exactly the arithmetic
+ * escapeTime would, so the results are identical; k gets each escape iteration
+ * (0 for none) and Z, Zi the orbit where the lanes stopped.
+ */
+template <unsigned int LANES>
+static void escapeTimeLanes(const double *x, double y, unsigned int iterations, unsigned int *k, double *Zout, double *Ziout)
+{
+	double Z[LANES], Zi[LANES], Zp[LANES];
+	unsigned int left = LANES;
+
+	for (unsigned int l = 0; l < LANES; ++l) {
+		Z[l] = Zi[l] = 0;
+		k[l] = 0;
+	}
+
+	for (unsigned int n = 1; n <= iterations && left > 0; ++n) {
+		for (unsigned int l = 0; l < LANES; ++l) {
+			Zp[l] = Z[l]*Z[l] - Zi[l]*Zi[l] + x[l];
+			Zi[l] = 2*Z[l]*Zi[l] + y;
+			Z[l] = Zp[l];
+		}
+
+		for (unsigned int l = 0; l < LANES; ++l) {
+			if (k[l] == 0 && (Z[l]*Z[l] + Zi[l]*Zi[l]) > 4) {
+				k[l] = n;
+				--left;
+			}
+		}
+	}
+
+	for (unsigned int l = 0; l < LANES; ++l) {
+		Zout[l] = Z[l];
+		Ziout[l] = Zi[l];
+	}
+}
+
+/**
+ * Computes the given columns of row j from scratch, lanes at a time (1 uses
+ * the plain kernel).  The orbits of pixels that do not escape go to pixels if
+ * it is given.
+ */
+void renderColumns(vector<vector<unsigned int>> &iterationBuffer, const View &view, unsigned int j, const vector<unsigned int> &columns, unsigned int lanes, PixelState *pixels)
+{
+	const double y = view.yStart + j * view.yStep;
+	double x[MAX_LANES], Z[MAX_LANES], Zi[MAX_LANES];
+	unsigned int k[MAX_LANES], n, i;
+
+	if (lanes != 2 && lanes != 4 && lanes != 8)
+		lanes = 1;
+
+	for (size_t c = 0; c < columns.size(); c += lanes) {
+		n = (unsigned int)min((size_t)lanes, columns.size() - c);
+
+		/* A short last batch just repeats its last column */
+		for (unsigned int l = 0; l < lanes; ++l)
+			x[l] = view.xStart + columns[c + min(l, n - 1)] * view.xStep;
+
+		if (lanes == 8) {
+			escapeTimeLanes<8>(x, y, view.iterations, k, Z, Zi);
+		} else if (lanes == 4) {
+			escapeTimeLanes<4>(x, y, view.iterations, k, Z, Zi);
+		} else if (lanes == 2) {
+			escapeTimeLanes<2>(x, y, view.iterations, k, Z, Zi);
+		} else {
+			Z[0] = Zi[0] = 0;
+			k[0] = escapeTimeFrom(x[0], y, 0, view.iterations, Z[0], Zi[0]);
+		}
+
+		for (unsigned int l = 0; l < n; ++l) {
+			i = columns[c + l];
+			iterationBuffer[j][i] = k[l];
+			if (pixels) {
+				pixels->Z[j][i] = Z[l];
+				pixels->Zi[j][i] = Zi[l];
+			}
+		}
+	}
+}
+
+/**
+ * Computes every pixel of one tile at the full iteration limit.  If pixels is
+ * given, known pixels already hold their final value and are left alone,
+ * resumed pixels carry on from their saved orbit, and every pixel that does
+ * not escape leaves its orbit behind in pixels->Z, pixels->Zi.
+ */
+static void renderTileFull(vector<vector<unsigned int>> &iterationBuffer, const View &view, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int lanes, PixelState *pixels)
+{
+	vector<unsigned int> columns;
+
+	columns.reserve(x1 - x0);
+
+	for (unsigned int j = y0; j < y1; ++j) {
+		columns.clear();
+
+		for (unsigned int i = x0; i < x1; ++i) {
+			if (!pixels) {
+				columns.push_back(i);
+			} else if (!pixels->known[j][i]) {
+				if (pixels->resume[j][i])
+					iterationBuffer[j][i] = escapeTimeFrom(view.xStart + i * view.xStep,
+							view.yStart + j * view.yStep, pixels->resumeFrom,
+							view.iterations, pixels->Z[j][i], pixels->Zi[j][i]);
+				else
+					columns.push_back(i);
+			}
+		}
+
+		renderColumns(iterationBuffer, view, j, columns, lanes, pixels);
+	}
+}
+
+/**
+ * Computes one sample per COARSE_STEP x COARSE_STEP block at a reduced
+ * iteration limit and copies it over the whole block
+ */
+static void renderTileCoarse(vector<vector<unsigned int>> &iterationBuffer, const View &view, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, const PixelState *pixels)
+{
+	unsigned int limit = min(view.iterations, COARSE_ITERATIONS);
+	unsigned int k;
+
+	for (unsigned int j = y0; j < y1; j += COARSE_STEP) {
+		for (unsigned int i = x0; i < x1; i += COARSE_STEP) {
+			k = escapeTime(view.xStart + i * view.xStep,
+					view.yStart + j * view.yStep, limit);
+
+			for (unsigned int jj = j; jj < min(j + COARSE_STEP, y1); ++jj)
+				for (unsigned int ii = i; ii < min(i + COARSE_STEP, x1); ++ii)
+					if (!pixels || !pixels->known[jj][ii])
+						iterationBuffer[jj][ii] = k;
+		}
+	}
+}
+
+/**
+ * Starts threadCount workers (the caller being one of them) and waits for them.
+ * Each is handed its number, 0 to threadCount - 1.
+ */
+void runWorkers(unsigned int threadCount, const function<void(unsigned int)> &work)
+{
+	vector<thread> workers;
+
+	for (unsigned int n = 1; n < threadCount; ++n)
+		workers.push_back(thread(work, n));
+	work(0);
+	for (unsigned int n = 0; n < workers.size(); ++n)
+		workers[n].join();
+}
+
+/**
+ * Escape-time render of one tile at the given quality, skipping known pixels
+ */
+static void renderTile(vector<vector<unsigned int>> &iterationBuffer, const View &view, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, TileState quality, unsigned int lanes, PixelState *pixels)
+{
+	if (quality == TILE_FULL) {
+		renderTileFull(iterationBuffer, view, x0, y0, x1, y1, lanes, pixels);
+	} else if (quality == TILE_COARSE) {
+		renderTileCoarse(iterationBuffer, view, x0, y0, x1, y1, pixels);
+	} else {
+		for (unsigned int j = y0; j < y1; ++j)
+			for (unsigned int i = x0; i < x1; ++i)
+				if (!pixels || !pixels->known[j][i])
+					iterationBuffer[j][i] = 0;
+	}
+}
+
+/**
+ * TILE SCHEDULER
+ *
+ * Splits the image into tileWidth x tileHeight tiles and hands them out to
+ * threadCount worker threads.
+ * Before starting each tile a worker checks the cancellation token and the
+ * deadline, then calls renderTile with the tile bounds and the quality it
+ * should be rendered at:  TILE_FULL normally, TILE_COARSE once the deadline has
+ * passed, TILE_SKIPPED (fill with "not escaped") after a cancel.  What happened
+ * to each tile is recorded in tileState (row-major, one entry per tile).
+ *
+ * Tiles go out in row-major order, or most expensive first if a cost map is
+ * given, so that no long tile is left running on its own at the end.
+ *
+ * Returns true if every tile was computed at full quality.
+ */
+static bool runTiles(vector<unsigned char> &tileState, const View &view, unsigned int tileWidth, unsigned int tileHeight, unsigned int threadCount, Deadline deadline, const atomic<bool> &cancel, const CostMap *costs, const function<void(unsigned int, unsigned int, unsigned int, unsigned int, TileState)> &renderTile)
+{
+	const unsigned int tilesPerRow = (view.pixelCount + tileWidth - 1) / tileWidth;
+	const unsigned int tilesPerColumn = (view.pixelCount + tileHeight - 1) / tileHeight;
+	const unsigned int tileCount = tilesPerRow * tilesPerColumn;
+
+	atomic<unsigned int> nextTile(0);
+	atomic<unsigned int> doneTiles(0);
+	atomic<bool> degraded(false);
+	vector<unsigned int> order(tileCount);
+	vector<double> tileCost(tileCount, 0);
+
+	tileState.assign(tileCount, TILE_PENDING);
+
+	for (unsigned int t = 0; t < tileCount; ++t)
+		order[t] = t;
+
+	if (costs) {
+		for (unsigned int j = 0; j < view.pixelCount; ++j)
+			for (unsigned int i = 0; i < view.pixelCount; ++i)
+				tileCost[(j / tileHeight) * tilesPerRow + i / tileWidth] +=
+					pixelCost(*costs, i, j);
+
+		stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+			return tileCost[a] > tileCost[b];
+		});
+	}
+
+	auto worker = [&](unsigned int) {
+		unsigned int t, x0, y0, x1, y1, done;
+		TileState quality;
+
+		while ((t = nextTile++) < tileCount) {
+			t = order[t];
+			x0 = (t % tilesPerRow) * tileWidth;
+			y0 = (t / tilesPerRow) * tileHeight;
+			x1 = min(x0 + tileWidth, view.pixelCount);
+			y1 = min(y0 + tileHeight, view.pixelCount);
+
+			if (cancel)
+				quality = TILE_SKIPPED;
+			else if (chrono::steady_clock::now() >= deadline)
+				quality = TILE_COARSE;
+			else
+				quality = TILE_FULL;
+
+			renderTile(x0, y0, x1, y1, quality);
+			tileState[t] = quality;
+			if (quality != TILE_FULL)
+				degraded = true;
+
+			done = ++doneTiles;
+			if (done * 100 / tileCount != (done - 1) * 100 / tileCount)
+				printf("\r%u%%", done * 100 / tileCount);
+		}
+	};
+
+	runWorkers(threadCount, worker);
+
+	return !degraded;
+}
+
+/**
+ * Distance-estimated tile with empty-disk skipping.  Distances are stored in
+ * pixels.  Every pixel at least DE_SHADE_PIXELS from the set is drawn the same
+ * colour, so when a computed pixel proves that a disk around it lies that far
+ * outside the set, the untouched pixels of the tile inside the disk are filled
+ * in without iterating them.  Returns the number of pixels iterated.
+ */
+static unsigned long long renderDistanceTile(vector<vector<float>> &distanceBuffer, const View &view, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+{
+	unsigned long long iterated = 0;
+	double d, r;
+	int reach;
+
+	for (unsigned int j = y0; j < y1; ++j)
+		fill(distanceBuffer[j].begin() + x0, distanceBuffer[j].begin() + x1, -1.0f);
+
+	for (unsigned int j = y0; j < y1; ++j) {
+		for (unsigned int i = x0; i < x1; ++i) {
+			if (distanceBuffer[j][i] >= 0)
+				continue;
+
+			d = distanceEstimate(view.xStart + i * view.xStep,
+					view.yStart + j * view.yStep, view.iterations) / fabs(view.xStep);
+			distanceBuffer[j][i] = (float)d;
+			++iterated;
+
+			/**
+			 * Anything within d/4 of this pixel is outside the set, and at
+			 * least d/4 - r from it when r away, so pixels closer than
+			 * d/4 - DE_SHADE_PIXELS are saturated.
+			 */
+			r = d / 4 - DE_SHADE_PIXELS;
+			if (r < 1)
+				continue;
+
+			reach = (int)r;
+			for (int jj = max((int)y0, (int)j - reach); jj < min((int)y1, (int)j + reach + 1); ++jj) {
+				for (int ii = max((int)x0, (int)i - reach); ii < min((int)x1, (int)i + reach + 1); ++ii) {
+					if (distanceBuffer[jj][ii] < 0 &&
+							(double)(ii - (int)i) * (ii - (int)i) + (double)(jj - (int)j) * (jj - (int)j) <= r * r)
+						distanceBuffer[jj][ii] = DE_SHADE_PIXELS;
+				}
+			}
+		}
+	}
+
+	return iterated;
+}
+
+/**
+ * DISTANCE ESTIMATED RENDER
+ *
+ * Fills distanceBuffer with the exterior distance of each pixel to the set,
+ * measured in pixels (0 for members of the set and for cancelled tiles), using
+ * the same tile scheduler, deadline and cancellation as renderPipelined.  The
+ * number of pixels actually iterated is returned through iterated.
+ *
+ * Returns true if every tile was computed at full quality.
+ */
+bool renderDistanceTiles(vector<vector<float>> &distanceBuffer, vector<unsigned char> &tileState, const View &view, const RenderConfig &config, Deadline deadline, const atomic<bool> &cancel, unsigned long long &iterated)
+{
+	atomic<unsigned long long> count(0);
+
+	bool complete = runTiles(tileState, view, max(config.tileSize, 1u),
+			max(config.tileSize, 1u), config.threadCount, deadline, cancel, NULL,
+			[&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, TileState quality) {
+		unsigned int limit = min(view.iterations, COARSE_ITERATIONS);
+		float d;
+
+		if (quality == TILE_FULL) {
+			count += renderDistanceTile(distanceBuffer, view, x0, y0, x1, y1);
+		} else if (quality == TILE_COARSE) {
+			for (unsigned int j = y0; j < y1; j += COARSE_STEP) {
+				for (unsigned int i = x0; i < x1; i += COARSE_STEP) {
+					d = (float)(distanceEstimate(view.xStart + i * view.xStep,
+							view.yStart + j * view.yStep, limit) / fabs(view.xStep));
+					++count;
+
+					for (unsigned int jj = j; jj < min(j + COARSE_STEP, y1); ++jj)
+						for (unsigned int ii = i; ii < min(i + COARSE_STEP, x1); ++ii)
+							distanceBuffer[jj][ii] = d;
+				}
+			}
+		} else {
+			for (unsigned int j = y0; j < y1; ++j)
+				fill(distanceBuffer[j].begin() + x0,
+						distanceBuffer[j].begin() + x1, 0.0f);
+		}
+	});
+
+	iterated = count;
+	return complete;
+}
+
+/**
+ * Bounded hand-off of finished bands between pipeline stages.  push blocks
+ * while the queue is full, pop blocks while it is empty and returns false once
+ * the queue has been closed and drained.
+ */
+class BandQueue
+{
+public:
+	BandQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+	void push(unsigned int band)
+	{
+		unique_lock<mutex> lock(guard);
+		notFull.wait(lock, [this]() { return bands.size() < capacity; });
+		bands.push_back(band);
+		notEmpty.notify_one();
+	}
+
+	bool pop(unsigned int &band)
+	{
+		unique_lock<mutex> lock(guard);
+		notEmpty.wait(lock, [this]() { return !bands.empty() || closed; });
+		if (bands.empty())
+			return false;
+		band = bands.front();
+		bands.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		lock_guard<mutex> lock(guard);
+		closed = true;
+		notEmpty.notify_all();
+	}
+
+private:
+	size_t                  capacity;
+	bool                    closed;
+	deque<unsigned int>     bands;
+	mutex                   guard;
+	condition_variable      notFull;
+	condition_variable      notEmpty;
+};
+
+/**
+ * PIPELINED RENDER
+ *
+ * Escape-time render that colours and writes the image while it is still being
+ * calculated.  The image is split into full-width bands of config.bandHeight
+ * rows which flow through three stages joined by bounded queues:
+ *
+ *	calculation (the tile scheduler's workers, on config.tileSize wide tiles
+ *		of each band with the usual deadline and cancellation behaviour,
+ *		the band moving on once all of its tiles are done) -> colouring (one thread running
+ *		hsvToRGBRow) -> writing (one thread seeking to each row's place in
+ *		the file, so bands can land in any order)
+ *
+ * The bitmap header must already be in the file; rows are written starting at
+ * dataOffset, bufferLength bytes each.  If pixels is not NULL, known pixels
+ * are not recalculated, resumed ones continue from their saved orbits and the
+ * orbits of pixels that do not escape are kept there (see renderTileFull).
+ * If costs is not NULL the most expensive bands are calculated first.
+ * Returns true if every tile was computed at full quality.
+ */
+bool renderPipelined(vector<vector<unsigned int>> &iterationBuffer, vector<vector<bool>> &escapeBuffer, vector<vector<char>> &colorBuffer, vector<unsigned char> &tileState, const View &view, const RenderConfig &config, Deadline deadline, const atomic<bool> &cancel, ofstream &file, streamoff dataOffset, unsigned int bufferLength, PixelState *pixels, const CostMap *costs)
+{
+	const unsigned int bandHeight = max(config.bandHeight, 1u);
+	const unsigned int tileWidth = max(config.tileSize, 1u);
+	const unsigned int bandCount = (view.pixelCount + bandHeight - 1) / bandHeight;
+	const unsigned int tilesPerBand = (view.pixelCount + tileWidth - 1) / tileWidth;
+	const size_t depth = max(2 * config.threadCount, 4u);
+
+	BandQueue toColour(depth);
+	BandQueue toWrite(depth);
+	vector<atomic<unsigned int>> tilesLeft(bandCount);
+	bool complete;
+
+	for (unsigned int b = 0; b < bandCount; ++b)
+		tilesLeft[b] = tilesPerBand;
+
+	thread colourer([&]() {
+		unsigned int band;
+
+		while (toColour.pop(band)) {
+			for (unsigned int j = band * bandHeight; j < min((band + 1) * bandHeight, view.pixelCount); ++j)
+				hsvToRGBRow(colorBuffer[j], iterationBuffer[j], escapeBuffer[j], view.pixelCount);
+			toWrite.push(band);
+		}
+		toWrite.close();
+	});
+
+	thread writer([&]() {
+		unsigned int band;
+
+		while (toWrite.pop(band)) {
+			for (unsigned int j = band * bandHeight; j < min((band + 1) * bandHeight, view.pixelCount); ++j) {
+				file.seekp(dataOffset + (streamoff)j * bufferLength);
+				file.write(&colorBuffer[j][0], bufferLength);
+			}
+		}
+	});
+
+	/**
+	 * Each band is split into tiles so the deadline and cancellation token
+	 * are still checked every tile.  Tiles of a band share the packed words
+	 * of its vector<bool> rows, so whoever finishes the band's last tile sets
+	 * the escape flags for the whole band and passes it on.
+	 */
+	complete = runTiles(tileState, view, tileWidth, bandHeight,
+			config.threadCount, deadline, cancel, costs,
+			[&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, TileState quality) {
+		const unsigned int band = y0 / bandHeight;
+
+		renderTile(iterationBuffer, view, x0, y0, x1, y1, quality, config.kernelLanes, pixels);
+
+		if (--tilesLeft[band] != 0)
+			return;
+
+		for (unsigned int j = y0; j < y1; ++j)
+			for (unsigned int i = 0; i < view.pixelCount; ++i)
+				escapeBuffer[j][i] = iterationBuffer[j][i] != 0;
+
+		toColour.push(band);
+	});
+
+	toColour.close();
+	colourer.join();
+	writer.join();
+
+	return complete;
+}
@@ -46,8 +46,6 @@
  *	on Ubuntu 12.04 64 bit and Windows 7 Home Premium 64 Bit.
  *
  *	The main calculation loop can probably be optimized
- *
- *	Multithreading the calculation loop would be awesome.
  */
 
 /**
@@ -58,7 +56,11 @@
 #define	_CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <cmath>
 #include <string>
@@ -68,6 +70,21 @@
 
 using namespace std;
 
+/**
+ * Set by ctrl-c while a render is running so the workers stop picking up new
+ * tiles and whatever has been computed so far still gets written out
+ */
+static atomic<bool> cancelRender(false);
+
+/**
+ * The first ctrl-c cancels the render; a second one quits like it used to
+ */
+void onInterrupt(int)
+{
+	cancelRender = true;
+	signal(SIGINT, SIG_DFL);
+}
+
 /**
  * Grabs a line from the language file
  */
@@ -104,6 +121,24 @@ bool isFloat (string str)
 	return str.find_first_not_of("0123456789.-") == string::npos;
 }
 
+/**
+ * Formats a number of seconds as something like "2h 05m", "3m 20s" or "4.2s"
+ */
+string durationToString (double seconds)
+{
+	char buffer[32];
+	unsigned long long whole = (unsigned long long)seconds;
+
+	if (whole >= 3600)
+		sprintf(buffer, "%lluh %02llum", whole / 3600, whole % 3600 / 60);
+	else if (whole >= 60)
+		sprintf(buffer, "%llum %02llus", whole / 60, whole % 60);
+	else
+		sprintf(buffer, "%.1fs", seconds);
+
+	return buffer;
+}
+
 /**
  * Application Entry Point
  */
@@ -111,6 +146,7 @@ int main(int argc, char *argv[])
 {
 	/* Forward Definitions of Variables */
 	const string currentVersion = "1.2.0";
+	const string profileFile    = "MandelbrotGenerator.profile";
 	const string cinFail        = "The input stream failed to write to \
                                        the string. Execution terminated. \
                                        Press 'enter' to continue.";
@@ -123,34 +159,29 @@ int main(int argc, char *argv[])
 	const string rangeWarning   = "Sorry, that number was out of the range.\
                                        Try again.";
 
-	bool outOfBounds; /*!< Tells if the sum escaped or not */
 	bool repeat = true;
+	bool distanceMode = false; /*!< Colour by distance estimate instead of escape time */
+	bool buddhabrotMode = false; /*!< Render orbit density instead of escape time */
+	bool saveOrbits = false; /*!< Save each escape-time frame so it can be resumed */
+	bool runAutotune = false; /*!< Calibrate this machine instead of rendering */
+	bool badArgs = false; /*!< Set if the command line could not be understood */
+	bool complete; /*!< Whether every tile of the render was done at full quality */
 	bool proceed;
 
 	/* string size; do we need this?? */
 	string userInput;
 	string fileName;
 
-	unsigned int i; /*!< Iteration integer declaration */
-	unsigned int j; /*!< Iteration integer declaration */
-	unsigned int k; /*!< Iteration integer declaration */
 	unsigned int pixelCount = 1200; /*!< Number of pixels in both the x and y directions */
 	unsigned int bufferLength; /*!< How long the array of calculated data must be */
 	/* unsigned int count; do we need this?? */
-	unsigned int percent; /*!< The value that is displayed telling the user the progress of the render */
 	unsigned int iterations; /*!< Number of iterations before escape for each pixel */
 	unsigned int usignInput [] = {0}; /*!< If the previous user input file doesn't exist, use this to create a new one. */
 
-	double Z; /*!< Real part of the complex argument */
-	double Zi; /*!< Imaginary part of the complex argument */
-	double Zp; /*!< Temporary variable for the real part of Z*Z */
-	double Zip; /*!< Temporary variable for the imaginary part of Z*Z */
-	double xStep; /*!< Width of each horizontal pixel in the complex plane */
-	double yStep; /*!< Height of each vertical pixel in the complex plane */
+	double samplesPerPixel = 0; /*!< Buddhabrot samples per pixel of the image */
+	double timeLimit = 0; /*!< Seconds each render may take before it degrades (0 = no limit) */
 	double xCent; /*!< X center coordinate for the image in the complex plane */
 	double yCent; /*!< Y center coordinate for the image in the complex plane */
-	double xPos; /*!< Horizontal position of current pixel being calculated */
-	double yPos; /*!< Vertical position of current pixel being calculated */
 	double xStart; /*!< Starting horizontal complex coordinate */
 	double xEnd; /*!< Ending horizontal complex coordinate */
 	double yStart; /*!< Starting vertical complex coordinate */
@@ -159,6 +190,74 @@ int main(int argc, char *argv[])
 	double floatInput [] = {0, 0, 0}; /*!< Array that will contain previous user input */
 
 	BMP bitmapData;	// Constructor is called from BMP.cpp
+	View view; /*!< Mapping of the pixels onto the complex plane */
+	RenderConfig renderConfig; /*!< Tile size and thread count */
+	Deadline deadline; /*!< When the current render has to be done by */
+	vector<unsigned char> tileState; /*!< What happened to each tile of the last render */
+	PixelState pixelState; /*!< Pixels of this render taken from the last one, and orbits */
+	Frame lastFrame; /*!< The last escape-time render, for "Go again" */
+
+	/**
+	 * Use this machine's tuned settings if it has any
+	 */
+	if (loadProfile(renderConfig, profileFile))
+		printf("Using the tuned settings for '%s' from %s.\n\n",
+			machineName().c_str(), profileFile.c_str());
+
+	/**
+	 * Command line options:
+	 *	autotune	find the fastest settings for this machine and exit
+	 *	-t <seconds>	time budget for each render
+	 *	-d		distance estimated render (skips empty exterior disks)
+	 *	-b <samples>	Buddhabrot render with this many samples per pixel
+	 *	-s		save each render's orbits next to the bitmap
+	 *	-r <file>	resume from orbits saved by an earlier run
+	 */
+	for (int arg = 1; arg < argc; ++arg) {
+		if (string(argv[arg]) == "-t" && arg + 1 < argc && isFloat(argv[arg + 1])) {
+			timeLimit = atof(argv[++arg]);
+			if (timeLimit < 0)
+				badArgs = true;
+		} else if (string(argv[arg]) == "-d") {
+			distanceMode = true;
+		} else if (string(argv[arg]) == "-b" && arg + 1 < argc && isFloat(argv[arg + 1])) {
+			buddhabrotMode = true;
+			samplesPerPixel = atof(argv[++arg]);
+			if (samplesPerPixel <= 0)
+				badArgs = true;
+		} else if (string(argv[arg]) == "autotune") {
+			runAutotune = true;
+		} else if (string(argv[arg]) == "-s") {
+			saveOrbits = true;
+		} else if (string(argv[arg]) == "-r" && arg + 1 < argc) {
+			if (!loadFrame(lastFrame, argv[++arg])) {
+				printf("Could not read saved orbits from '%s'\n", argv[arg]);
+				return -1;
+			}
+		} else {
+			badArgs = true;
+		}
+	}
+
+	if (badArgs || (distanceMode && buddhabrotMode)) {
+		printf("Usage: %s [autotune] [-t seconds] [-d | -b samples] [-s] [-r file]\n", argv[0]);
+		return -1;
+	}
+
+	if (runAutotune) {
+		printf("Timing calibration renders to find the fastest settings for "
+			"'%s'...\n\n", machineName().c_str());
+		autotune(renderConfig);
+
+		if (!saveProfile(renderConfig, profileFile)) {
+			printf("Could not write %s!\n", profileFile.c_str());
+			return -1;
+		}
+
+		printf("Saved to %s; renders on this machine will use these settings "
+			"from now on.\n", profileFile.c_str());
+		return 0;
+	}
 
 	getStringFromFile();
 
@@ -212,6 +311,8 @@ int main(int argc, char *argv[])
 	vector<vector<char>> colorBuffer (pixelCount, vector<char>(bufferLength, 0x0));
 	vector<vector<unsigned int>> iterationBuffer (pixelCount,
 			vector<unsigned int>(pixelCount, 0x0));
+	vector<vector<float>> distanceBuffer (distanceMode || buddhabrotMode ? pixelCount : 0,
+			vector<float>(pixelCount, 0));
 
 	printf("        Weikardzaena's Mandelbrot Set Generator\n\n"
 
@@ -267,7 +368,26 @@ int main(int argc, char *argv[])
 "HOWEVER increasing the iterations increases the render time exponentially. It\n"
 "could be HOURS at some values...  Basically anything below about 500 will be\n"
 "fine for all but the smallest details, but for enthusiasts the number can be\n"
-"up to 1 million iterations per pixel.\n\n"
+"up to 1 million iterations per pixel.  Before each render a quick sample of the\n"
+"view is taken to tell you roughly how long it is going to take.\n\n"
+
+"When you go again, pixels of the new view that line up exactly with pixels of\n"
+"the last one are reused instead of recalculated:  pan by a whole number of\n"
+"pixels (each is radius / 600 wide) or halve or double the radius.  Keeping the\n"
+"same view and raising the iterations only continues the pixels that had not\n"
+"escaped yet.  Run with '-s' to save those orbits next to the image, and with\n"
+"'-r <file>' to pick up from a saved file in a later run.\n\n"
+
+"Run with 'autotune' once on each machine to find the thread count, kernel\n"
+"width and band and tile sizes that render fastest there; they are saved to\n"
+"MandelbrotGenerator.profile and picked up automatically afterwards.\n\n"
+
+"Pressing ctrl-c during a render stops it early and still writes out what has\n"
+"been computed; run with '-t <seconds>' to give every render a time budget\n"
+"after which the rest of the image is sampled coarsely, or with '-d' to shade the\n"
+"image by distance to the set, which is much faster on views that are mostly\n"
+"outside of it.  '-b <samples>' renders the Buddhabrot instead:  the density of\n"
+"escaping orbits, using the chosen number of iterations as the orbit length.\n\n"
 
 "Have fun with it! Press ctrl-c at any time to quit.\n\n", currentVersion.c_str());
 
@@ -309,8 +429,8 @@ int main(int argc, char *argv[])
 				printf ("\n%s\n", floatWarning.c_str());
 			} else {
 				if (userInput.length() < 10) {
-					if (stof (userInput) < 2 && stof (userInput) > -2)
-						xCent = stof (userInput);
+					if (stod (userInput) < 2 && stod (userInput) > -2)
+						xCent = stod (userInput);
 					else
 						xCent = 3;
 				} else {
@@ -339,8 +459,8 @@ int main(int argc, char *argv[])
 				printf ("\n%s\n", floatWarning.c_str());
 			} else {
 				if (userInput.length() < 10) {
-					if (stof(userInput) < 2 && stof(userInput) > -2) {
-						yCent = stof(userInput);
+					if (stod(userInput) < 2 && stod(userInput) > -2) {
+						yCent = stod(userInput);
 /* Only write this to the file once the user has submitted the next one which
    make sure they want to keep the last value they entered */
 						fwrite(&xCent, sizeof(double), 1,
@@ -374,9 +494,9 @@ int main(int argc, char *argv[])
 				printf ("\n%s\n", floatWarning.c_str());
 			} else {
 				if (userInput.length() < 10) {
-					if (stof(userInput) <= 2) {
+					if (stod(userInput) <= 2) {
 						fwrite(&yCent, sizeof(double), 1, prevInputFile);
-						radius = stof(userInput);
+						radius = stod(userInput);
 					} else {
 						radius = 3;
 					}
@@ -393,11 +513,9 @@ int main(int argc, char *argv[])
 		xEnd	= xCent + radius;
 		yStart	= yCent - radius;
 		yEnd	= yCent + radius;
-		xPos	= xStart;
-		yPos	= yStart;
 		
 		fileName = "MandelbrotSet_" + to_string(xCent) + "_" +
-				to_string(yCent) + "_" + to_string(radius) + ".bmp";
+				to_string(yCent) + "_" + to_string(radius) + (distanceMode ? "_DE" : buddhabrotMode ? "_BB" : "") + ".bmp";
 		
 		while (iterations > 4294967294) {
 			iterations = 0xffffffff;
@@ -458,69 +576,109 @@ int main(int argc, char *argv[])
 		dataFile.write(reinterpret_cast <char*>(&bitmapData), sizeof(bitmapData));
 
 		/* Set miscellaneous values needed for calculation */
-		xStep = (double)(xEnd - xStart)/pixelCount;
-		yStep = (double)(yEnd - yStart)/pixelCount;
+		view.xStart = xStart;
+		view.yStart = yStart;
+		view.xStep = (double)(xEnd - xStart)/pixelCount;
+		view.yStep = (double)(yEnd - yStart)/pixelCount;
+		view.pixelCount = pixelCount;
+		view.iterations = iterations;
+
+		if (timeLimit > 0)
+			deadline = chrono::steady_clock::now() +
+				chrono::duration_cast<chrono::steady_clock::duration>(
+						chrono::duration<double>(timeLimit));
+		else
+			deadline = Deadline::max();
 
 		/**
 		 * Main calculation loop
 		 */
-		for (j = 0; j < pixelCount; ++j) {
-			percent = int(fabs(yPos-yStart)/(yEnd - yStart) * 100);
-			printf("\r%d%%",percent);
-		
-			xPos = xStart;
-		
-			for (i = 0; i < pixelCount; ++i) {
-				Z = 0;
-				Zi = 0;
-				k = 0;
-				outOfBounds = true;
-			
-				while (k < iterations) {
-					/**
-					 * The ++k needs to be first because sometimes 
-					 * the sum escapes on the first iteration,
-					 * and we don't want k to be zero if it
-					 * escapes because that's how we tell if
-					 * the pixel is a member of the set.
-					 */
-					++k;
-				
-					Zp = Z*Z - Zi*Zi + xPos;
-					Zip = 2*Z*Zi + yPos;
+		cancelRender = false;
+		signal(SIGINT, onInterrupt);
+
+		if (buddhabrotMode) {
+			complete = renderBuddhabrot(distanceBuffer, view, renderConfig,
+					samplesPerPixel, deadline, cancelRender);
+			if (!complete)
+				printf("\nStopped before taking every sample, the image "
+					"will be noisier.\n");
+			complete = true;
+		} else if (distanceMode) {
+			unsigned long long iterated;
+
+			complete = renderDistanceTiles(distanceBuffer, tileState, view,
+					renderConfig, deadline, cancelRender, iterated);
+			printf("\nIterated %llu of %u pixels, the rest lie in empty "
+				"disks outside the set.\n", iterated, pixelCount * pixelCount);
+		} else {
+			unsigned int resumed;
+			unsigned int reused = reuseFrame(lastFrame, view,
+					iterationBuffer, pixelState, resumed);
+
+			if (reused > 0)
+				printf("Reusing %u of %u pixels from the last render "
+					"(%u of them continue from %u iterations).\n\n",
+					reused, pixelCount * pixelCount, resumed,
+					pixelState.resumeFrom);
+
+			CostMap costs = estimateCost(view, renderConfig, &pixelState,
+					deadline, cancelRender);
+			Deadline started = chrono::steady_clock::now();
+
+			if (costs.seconds > 0)
+				printf("Expecting about %.3g iterations, which should take "
+					"%s.\n\n", costs.iterations,
+					durationToString(costs.seconds).c_str());
+
+			/* Colours and writes the bands as they finish, costliest first if there is an estimate */
+			complete = renderPipelined(iterationBuffer, escapeBuffer,
+					colorBuffer, tileState, view, renderConfig, deadline,
+					cancelRender, dataFile, sizeof(bitmapData), bufferLength,
+					&pixelState, costs.sampleCost.empty() ? NULL : &costs);
+
+			printf("\rTook %s.\n", durationToString(chrono::duration<double>(
+					chrono::steady_clock::now() - started).count()).c_str());
+
+			keepFrame(lastFrame, view, iterationBuffer, pixelState,
+					tileState, renderConfig);
+
+			if (saveOrbits) {
+				string orbitFile = fileName.substr(0, fileName.size() - 4) + ".orbits";
+				if (!saveFrame(lastFrame, orbitFile))
+					printf("\nCould not save the orbits to '%s'.\n", orbitFile.c_str());
+			}
+		}
 
-					Z = Zp;
-					Zi = Zip;
-			
-					if ((Z*Z + Zi*Zi) > 4) {
-						iterationBuffer.at(j).at(i) = k;
-						outOfBounds = false;
-						k = iterations;
-					}
-				}
-			
-				if (outOfBounds)
-					escapeBuffer.at(j).at(i) = false;
-				else
-					escapeBuffer.at(j).at(i) = true;
-				xPos += xStep;
+		if (!complete) {
+			unsigned int coarse = 0, skipped = 0;
+			for (unsigned int t = 0; t < tileState.size(); ++t) {
+				if (tileState[t] == TILE_COARSE)
+					++coarse;
+				else if (tileState[t] == TILE_SKIPPED)
+					++skipped;
 			}
-			yPos += yStep;
+			printf("\n%u of %u tiles ran out of time and were sampled coarsely, "
+				"%u were cancelled.\n", coarse, (unsigned int)tileState.size(), skipped);
 		}
 
+		signal(SIGINT, SIG_DFL);
+
 				
 		/* Normalize all iteration data to 360 for HSV to RGB conversion */
 		//normalize (iterationBuffer, escapeBuffer, pixelCount, iterations);
 
 		/**
-		 * Set rgb values in the buffer array
+		 * Set rgb values in the buffer array and write it to the bitmap
+		 * file (the escape-time render already did both as it went)
 		 */
-		hsvToRGB (colorBuffer, iterationBuffer, escapeBuffer, pixelCount);
+		if (buddhabrotMode || distanceMode) {
+			if (buddhabrotMode)
+				densityToRGB (colorBuffer, distanceBuffer, pixelCount);
+			else
+				distanceToRGB (colorBuffer, distanceBuffer, pixelCount);
 
-		/**
-		 * Write the data array to the bitmap file
-		 */
-		writeBMP (colorBuffer, dataFile, bufferLength, pixelCount);
+			writeBMP (colorBuffer, dataFile, bufferLength, pixelCount);
+		}
 
 		dataFile.close();
 	